@@ -8,6 +8,7 @@
 #include <cassert>
 #include <iostream>
 #include <type_traits>
+#include <limits>
 
 #include "kde-kernels.hpp"
 
@@ -18,6 +19,29 @@ namespace fscr
     public:
     enum class Bandwith { Scott, Silverman, Custom };
 
+    /**
+     * @brief Density with its first and second derivative, evaluated at every x_domain point
+     */
+    struct PdfDerivatives {
+      std::vector<double> pdf;
+      std::vector<double> first;
+      std::vector<double> second;
+    };
+
+    /**
+     * @brief Local maximum of the density; curvature is f''(location), negative for a proper peak
+     */
+    struct Mode {
+      double location;
+      double density;
+      double curvature;
+    };
+
+    /**
+     * @brief Upper bound on the number of seed density passes made by modes()
+     */
+    static constexpr size_t max_mode_seeds() { return 256; }
+
     private:
     inline static double scott_h(const double stdev, const double n) {
       return 1.06 * stdev * std::pow(n, -0.2);
@@ -43,22 +67,22 @@ namespace fscr
       double IQR = static_cast<double>(Q3 - Q1);
       
       double IQR_div = IQR / 1.34;
-      double A = std::min(stdev, IQR_div);
+      // quantized data easily has IQR = 0, fall back to the standard deviation alone
+      double A = (IQR_div > 0.0) ? std::min(stdev, IQR_div) : stdev;
       return 0.9 * A * std::pow(n, -0.2);
     }
 
-    template<typename T, typename U, typename F>
-    static std::vector<double> pdf(const std::vector<T>& data, const std::vector<U>& x_domain, F &&kernel, Bandwith bandwith_type, double bandwith) {
-      static_assert(std::is_arithmetic<T>(), "Data types can only be arithmetic (integral or floating-point type");
-      static_assert(std::is_arithmetic<U>(), "X domain types can only be arithmetic (integral or floating-point type");
-      if (data.size() == 0) {
-        std::cerr << "fscr::KDE::pdf() - WARNING: empty data! (1st arg)" << std::endl;
-        return std::vector<double>{};
-      }
-      if (x_domain.size() == 0) {
-        std::cerr << "fscr::KDE::pdf() - WARNING: empty x_domain! (2nd arg)" << std::endl;
-        return std::vector<double>{};
+    inline static bool valid_bandwith(const double bandwith, const char *func_name) {
+      if (std::isfinite(bandwith) && bandwith > 0.0) {
+        return true;
       }
+      std::cerr << "fscr::KDE::" << func_name << "() - WARNING: bandwith must be finite and positive, got " << bandwith
+                << " (zero spread data?)" << std::endl;
+      return false;
+    }
+
+    template<typename T>
+    static double select_bandwith(const std::vector<T>& data, Bandwith bandwith_type, double bandwith) {
       const double n = static_cast<double>(data.size());
 
       double sum = std::accumulate(data.begin(), data.end(), 0.0);
@@ -69,15 +93,52 @@ namespace fscr
       }
       double stdev = std::sqrt(accum / (n - 1));
 
-      const auto minmax_itr = std::minmax_element(data.begin(), data.end());
-      const double min_val = static_cast<double>(*(minmax_itr.first));
-      const double max_val = static_cast<double>(*(minmax_itr.second));
-      
       if (bandwith_type == Bandwith::Scott) {
         bandwith = scott_h(stdev, n);
       } else if (bandwith_type == Bandwith::Silverman) {
         bandwith = silverman_h(data, stdev);
       }
+      return bandwith;
+    }
+
+    /**
+     * @brief Density and its first and second derivative at x, summed in a single pass over data
+     */
+    template<typename T, typename F>
+    static KernelDerivatives evaluate(const std::vector<T>& data, const double x, F &&kernel_derivatives, const double bandwith) {
+      KernelDerivatives sum{0.0, 0.0, 0.0};
+      for (const auto xi: data) {
+        const KernelDerivatives k = kernel_derivatives((x - xi) / bandwith);
+        sum.value += k.value;
+        sum.first += k.first;
+        sum.second += k.second;
+      }
+      // d/dx K((x - xi) / h) = K'(u) / h, hence the extra 1/h per derivative order
+      const double one_nh = 1.0 / (static_cast<double>(data.size()) * bandwith);
+      return KernelDerivatives{
+        one_nh * sum.value,
+        one_nh / bandwith * sum.first,
+        one_nh / (bandwith * bandwith) * sum.second
+      };
+    }
+
+    template<typename T, typename U, typename F>
+    static std::vector<double> pdf(const std::vector<T>& data, const std::vector<U>& x_domain, F &&kernel, Bandwith bandwith_type, double bandwith) {
+      static_assert(std::is_arithmetic<T>(), "Data types can only be arithmetic (integral or floating-point type");
+      static_assert(std::is_arithmetic<U>(), "X domain types can only be arithmetic (integral or floating-point type");
+      if (data.size() == 0) {
+        std::cerr << "fscr::KDE::pdf() - WARNING: empty data! (1st arg)" << std::endl;
+        return std::vector<double>{};
+      }
+      if (x_domain.size() == 0) {
+        std::cerr << "fscr::KDE::pdf() - WARNING: empty x_domain! (2nd arg)" << std::endl;
+        return std::vector<double>{};
+      }
+      const double n = static_cast<double>(data.size());
+      bandwith = select_bandwith(data, bandwith_type, bandwith);
+      if (!valid_bandwith(bandwith, "pdf")) {
+        return std::vector<double>{};
+      }
 
       std::vector<double> y_pdf;
       y_pdf.reserve(x_domain.size());
@@ -95,6 +156,203 @@ namespace fscr
 
       return y_pdf;
     }
+
+    template<typename T, typename U, typename F>
+    static PdfDerivatives pdf_derivatives(const std::vector<T>& data, const std::vector<U>& x_domain, F &&kernel_derivatives, Bandwith bandwith_type, double bandwith) {
+      static_assert(std::is_arithmetic<T>(), "Data types can only be arithmetic (integral or floating-point type");
+      static_assert(std::is_arithmetic<U>(), "X domain types can only be arithmetic (integral or floating-point type");
+      if (data.size() == 0) {
+        std::cerr << "fscr::KDE::pdf_derivatives() - WARNING: empty data! (1st arg)" << std::endl;
+        return PdfDerivatives{};
+      }
+      if (x_domain.size() == 0) {
+        std::cerr << "fscr::KDE::pdf_derivatives() - WARNING: empty x_domain! (2nd arg)" << std::endl;
+        return PdfDerivatives{};
+      }
+      bandwith = select_bandwith(data, bandwith_type, bandwith);
+      if (!valid_bandwith(bandwith, "pdf_derivatives")) {
+        return PdfDerivatives{};
+      }
+
+      PdfDerivatives ret;
+      ret.pdf.reserve(x_domain.size());
+      ret.first.reserve(x_domain.size());
+      ret.second.reserve(x_domain.size());
+
+      for (const auto x: x_domain) {
+        const KernelDerivatives d = evaluate(data, static_cast<double>(x), kernel_derivatives, bandwith);
+        ret.pdf.push_back(d.value);
+        ret.first.push_back(d.first);
+        ret.second.push_back(d.second);
+      }
+
+      return ret;
+    }
+
+    /**
+     * @brief Refine the maximum of the density inside [lo, hi], where f'(lo) > 0 and f'(hi) <= 0.
+     * Newton steps on f' are taken while they stay inside the bracket, bisection otherwise.
+     */
+    template<typename T, typename F>
+    static Mode refine_mode(const std::vector<T>& data, F &&kernel_derivatives, const double bandwith, double lo, double hi, double x) {
+      const double tolerance = 1e-10 * bandwith;
+      const int max_iteration = 100;
+
+      KernelDerivatives d = evaluate(data, x, kernel_derivatives, bandwith);
+      for (int i=0; i<max_iteration; ++i) {
+        if (d.first == 0.0) {
+          break;
+        }
+        if (d.first > 0.0) {
+          lo = x;
+        } else {
+          hi = x;
+        }
+
+        double x_next = lo + 0.5 * (hi - lo);
+        if (d.second < 0.0) {
+          const double x_newton = x - d.first / d.second;
+          if (x_newton > lo && x_newton < hi) {
+            x_next = x_newton;
+          }
+        }
+
+        if (std::abs(x_next - x) <= tolerance || (hi - lo) <= tolerance) {
+          break;
+        }
+        x = x_next;
+        d = evaluate(data, x, kernel_derivatives, bandwith);
+      }
+
+      return Mode{x, d.value, d.second};
+    }
+
+    /**
+     * @brief Refine the peaks between two neighbouring seeds a < b into ret.
+     * A +/- sign change of f' brackets a peak. When f' keeps its sign but f'' changes it, f' has an extremum
+     * inside that may cross 0 (a peak and the dip after it both between the seeds), so the interval is split
+     * at the zero of f'' (regula falsi) and both halves are scanned again.
+     */
+    template<typename T, typename F>
+    static void scan_interval(const std::vector<T>& data, F &&kernel_derivatives, const double bandwith,
+                              const double a, const KernelDerivatives& d_a, const double b, const KernelDerivatives& d_b,
+                              int& probes_left, std::vector<Mode>& ret) {
+      const bool bracket = d_a.first > 0.0 && d_b.first <= 0.0;
+      const bool rising = d_a.first > 0.0 && d_b.first > 0.0 && d_a.second < 0.0 && d_b.second > 0.0;
+      const bool falling = d_a.first < 0.0 && d_b.first < 0.0 && d_a.second > 0.0 && d_b.second < 0.0;
+
+      if (probes_left > 0 && (rising || falling)) {
+        --probes_left;
+        const double x = a - d_a.second * (b - a) / (d_b.second - d_a.second);
+        const KernelDerivatives d = evaluate(data, x, kernel_derivatives, bandwith);
+        scan_interval(data, kernel_derivatives, bandwith, a, d_a, x, d, probes_left, ret);
+        scan_interval(data, kernel_derivatives, bandwith, x, d, b, d_b, probes_left, ret);
+        return;
+      }
+      if (bracket) {
+        const double x_start = (d_a.value >= d_b.value) ? a : b;
+        ret.push_back(refine_mode(data, kernel_derivatives, bandwith, a, b, x_start));
+      }
+    }
+
+    template<typename T, typename F>
+    static std::vector<Mode> modes(const std::vector<T>& data, F &&kernel_derivatives, Bandwith bandwith_type, double bandwith) {
+      static_assert(std::is_arithmetic<T>(), "Data types can only be arithmetic (integral or floating-point type");
+      if (data.size() == 0) {
+        std::cerr << "fscr::KDE::modes() - WARNING: empty data! (1st arg)" << std::endl;
+        return std::vector<Mode>{};
+      }
+      bandwith = select_bandwith(data, bandwith_type, bandwith);
+      if (!valid_bandwith(bandwith, "modes")) {
+        return std::vector<Mode>{};
+      }
+
+      std::vector<double> sorted(data.begin(), data.end());
+      std::sort(sorted.begin(), sorted.end());
+
+      // Split the data into clusters at gaps wider than 3 bandwiths. The kernels are (close to) zero there,
+      // so the density has no peak inside a gap and seeding it would only waste passes.
+      struct Cluster {
+        double min_val;
+        double max_val;
+        size_t count;
+      };
+      std::vector<Cluster> clusters{Cluster{sorted.front(), sorted.front(), 0}};
+      for (const auto x: sorted) {
+        if (x - clusters.back().max_val > 3.0 * bandwith) {
+          clusters.push_back(Cluster{x, x, 0});
+        }
+        clusters.back().max_val = x;
+        ++clusters.back().count;
+      }
+
+      // A lone point costs 3 seeds (both edges and itself), a wider cluster one more for rounding up its
+      // interior seeds. Keep the most populated clusters when they do not all fit the budget.
+      const size_t num_clusters = clusters.size();
+      std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) {
+        return a.count > b.count;
+      });
+      std::vector<Cluster> kept;
+      size_t base_seeds = 0;
+      for (const auto& c: clusters) {
+        const size_t cost = (c.max_val > c.min_val) ? 4 : 3;
+        if (base_seeds + cost <= max_mode_seeds()) {
+          kept.push_back(c);
+          base_seeds += cost;
+        }
+      }
+      std::sort(kept.begin(), kept.end(), [](const Cluster& a, const Cluster& b) {
+        return a.min_val < b.min_val;
+      });
+      clusters.swap(kept);
+      if (clusters.size() < num_clusters) {
+        std::cerr << "fscr::KDE::modes() - WARNING: seed budget exhausted, only " << clusters.size() << " of "
+                  << num_clusters << " data clusters searched!" << std::endl;
+      }
+
+      // Seeds are spaced half a bandwith apart (peaks are roughly a bandwith wide), widened when the
+      // clusters span more than the remaining seed budget.
+      double total_width = 0.0;
+      for (const auto& c: clusters) {
+        total_width += c.max_val - c.min_val;
+      }
+      const double interior_budget = static_cast<double>(max_mode_seeds() - base_seeds);
+      double spacing = 0.5 * bandwith;
+      if (total_width > spacing * interior_budget) {
+        spacing = (interior_budget > 0.0) ? total_width / interior_budget : std::numeric_limits<double>::infinity();
+        std::cerr << "fscr::KDE::modes() - WARNING: seed budget exhausted, seeds are " << spacing / bandwith
+                  << " bandwiths apart, narrow peaks may be missed!" << std::endl;
+      }
+
+      const int max_interval_probes = 4;
+      std::vector<Mode> ret;
+      for (const auto& c: clusters) {
+        // Each cluster is enclosed by a seed half a bandwith outside of it, where f' > 0 on the left and f' < 0
+        // on the right, so a peak sitting exactly on a lone data point is still bracketed.
+        const size_t num_interior = static_cast<size_t>(std::ceil((c.max_val - c.min_val) / spacing));
+        const double interval = (num_interior > 0) ? (c.max_val - c.min_val) / static_cast<double>(num_interior) : 0.0;
+
+        double x_prev = c.min_val - 0.5 * bandwith;
+        KernelDerivatives d_prev = evaluate(data, x_prev, kernel_derivatives, bandwith);
+        for (size_t i=0; i<=num_interior+1; ++i) {
+          double x;
+          if (i == num_interior + 1) {
+            x = c.max_val + 0.5 * bandwith;
+          } else if (i == num_interior) {
+            x = c.max_val;
+          } else {
+            x = c.min_val + (interval * i);
+          }
+          const KernelDerivatives d = evaluate(data, x, kernel_derivatives, bandwith);
+          int probes_left = max_interval_probes;
+          scan_interval(data, kernel_derivatives, bandwith, x_prev, d_prev, x, d, probes_left, ret);
+          x_prev = x;
+          d_prev = d;
+        }
+      }
+
+      return ret;
+    }
     
     public:
     /**
@@ -137,6 +395,97 @@ namespace fscr
     static std::vector<double> pdf(const std::vector<T>& data, const std::vector<T>& x_domain, F &&kernel, double bandwith_val) {
       return pdf(data, x_domain, kernel, Bandwith::Custom, bandwith_val);
     }
+
+    /**
+     * @brief PDF with its 1st and 2nd derivative, default Gaussian kernel - pdf_derivatives(data, x_domain, bandwith_type)
+     */
+    template<typename T>
+    static PdfDerivatives pdf_derivatives(const std::vector<T>& data, const std::vector<T>& x_domain, Bandwith bandwith_type=Bandwith::Scott) {
+      return pdf_derivatives(data, x_domain, GaussianKernelDerivatives, bandwith_type, -1.0);
+    }
+
+    /**
+     * @brief PDF with its 1st and 2nd derivative, custom bandwith value - pdf_derivatives(data, x_domain, bandwith_val)
+     */
+    template<typename T>
+    static PdfDerivatives pdf_derivatives(const std::vector<T>& data, const std::vector<T>& x_domain, double bandwith_val) {
+      return pdf_derivatives(data, x_domain, GaussianKernelDerivatives, Bandwith::Custom, bandwith_val);
+    }
+
+    /**
+     * @brief PDF with its 1st and 2nd derivative, kernel derivatives parameter - pdf_derivatives(data, x_domain, kernel_derivatives)
+     */
+    template<typename T, typename F>
+    static PdfDerivatives pdf_derivatives(const std::vector<T>& data, const std::vector<T>& x_domain, F &&kernel_derivatives) {
+      return pdf_derivatives(data, x_domain, kernel_derivatives, Bandwith::Scott, -1.0);
+    }
+
+    /**
+     * @brief PDF with its 1st and 2nd derivative, kernel derivatives and bandwith selection algorithm parameter - pdf_derivatives(data, x_domain, kernel_derivatives, bandwith_type)
+     */
+    template<typename T, typename F>
+    static PdfDerivatives pdf_derivatives(const std::vector<T>& data, const std::vector<T>& x_domain, F &&kernel_derivatives, Bandwith bandwith_type) {
+      assert(bandwith_type != Bandwith::Custom);
+      return pdf_derivatives(data, x_domain, kernel_derivatives, bandwith_type, -1.0);
+    }
+
+    /**
+     * @brief PDF with its 1st and 2nd derivative, kernel derivatives and custom bandwith - pdf_derivatives(data, x_domain, kernel_derivatives, bandwith_val)
+     */
+    template<typename T, typename F>
+    static PdfDerivatives pdf_derivatives(const std::vector<T>& data, const std::vector<T>& x_domain, F &&kernel_derivatives, double bandwith_val) {
+      return pdf_derivatives(data, x_domain, kernel_derivatives, Bandwith::Custom, bandwith_val);
+    }
+
+    /**
+     * @brief Modes (peaks) of the density, default Gaussian kernel - modes(data, bandwith_type)
+     * 
+     * The sorted data is split into clusters at gaps wider than 3 bandwiths and seeds are placed half a
+     * bandwith apart inside each cluster. Every bracketed peak is refined with safeguarded Newton steps.
+     * Between two seeds where f' keeps its sign but f'' changes sign, up to 4 probes look for a hidden peak.
+     * Cost: at most max_mode_seeds() seed passes, up to 4 probe passes per such interval and a few Newton
+     * passes per mode, each pass being O(n). When the data does not fit the seed budget, the seeds are
+     * spread further apart or only the most populated clusters are searched, and a warning is printed.
+     * Near-flat tops splitting into two peaks closer than the seed spacing may still be reported as one.
+     * Curvature is only meaningful for kernels that are twice differentiable inside their support.
+     */
+    template<typename T>
+    static std::vector<Mode> modes(const std::vector<T>& data, Bandwith bandwith_type=Bandwith::Scott) {
+      return modes(data, GaussianKernelDerivatives, bandwith_type, -1.0);
+    }
+
+    /**
+     * @brief Modes (peaks) of the density, custom bandwith value - modes(data, bandwith_val)
+     */
+    template<typename T>
+    static std::vector<Mode> modes(const std::vector<T>& data, double bandwith_val) {
+      return modes(data, GaussianKernelDerivatives, Bandwith::Custom, bandwith_val);
+    }
+
+    /**
+     * @brief Modes (peaks) of the density, kernel derivatives parameter - modes(data, kernel_derivatives)
+     */
+    template<typename T, typename F>
+    static std::vector<Mode> modes(const std::vector<T>& data, F &&kernel_derivatives) {
+      return modes(data, kernel_derivatives, Bandwith::Scott, -1.0);
+    }
+
+    /**
+     * @brief Modes (peaks) of the density, kernel derivatives and bandwith selection algorithm parameter - modes(data, kernel_derivatives, bandwith_type)
+     */
+    template<typename T, typename F>
+    static std::vector<Mode> modes(const std::vector<T>& data, F &&kernel_derivatives, Bandwith bandwith_type) {
+      assert(bandwith_type != Bandwith::Custom);
+      return modes(data, kernel_derivatives, bandwith_type, -1.0);
+    }
+
+    /**
+     * @brief Modes (peaks) of the density, kernel derivatives and custom bandwith - modes(data, kernel_derivatives, bandwith_val)
+     */
+    template<typename T, typename F>
+    static std::vector<Mode> modes(const std::vector<T>& data, F &&kernel_derivatives, double bandwith_val) {
+      return modes(data, kernel_derivatives, Bandwith::Custom, bandwith_val);
+    }
     
   };
 }
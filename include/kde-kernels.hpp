@@ -80,6 +80,90 @@ namespace fscr
       return M_2_PI * (1.0 / (std::exp(x) + std::exp(-x)));
     }
   } SigmoidFunctionKernel;
+
+  /**
+   * @brief Kernel value with its first and second derivative, K(x), K'(x), K''(x)
+   * 
+   * Only provided for kernels that are twice differentiable inside their support. BoxCar and
+   * Triangular have none: their derivatives are Dirac deltas at the window edges and at 0.
+   */
+  struct KernelDerivatives {
+    double value;
+    double first;
+    double second;
+  };
+
+  struct {
+    inline KernelDerivatives operator()(const double x) {
+      const double k = 1.0 / std::sqrt(2 * M_PI) * std::exp(-0.5 * x * x);
+      return KernelDerivatives{k, -x * k, (x * x - 1.0) * k};
+    }
+  } GaussianKernelDerivatives;
+
+  struct {
+    inline KernelDerivatives operator()(const double x) {
+      if (std::abs(x) > 1.0) return KernelDerivatives{0.0, 0.0, 0.0};
+      return KernelDerivatives{0.75 * (1 - x * x), -1.5 * x, -1.5};
+    }
+  } EpanechnikovKernelDerivatives;
+
+  struct {
+    inline KernelDerivatives operator()(const double x) {
+      if (std::abs(x) > 1.0) return KernelDerivatives{0.0, 0.0, 0.0};
+      const double temp = 1 - (x * x);
+      return KernelDerivatives{0.9375 * (temp * temp), -3.75 * x * temp, 0.9375 * (12.0 * x * x - 4.0)};
+    }
+  } QuarticKernelDerivatives;
+
+  struct {
+    inline KernelDerivatives operator()(const double x) {
+      if (std::abs(x) > 1.0) return KernelDerivatives{0.0, 0.0, 0.0};
+      const double temp = 1 - (x * x);
+      return KernelDerivatives{
+        1.09375 * (temp * temp * temp),
+        -6.5625 * x * (temp * temp),
+        -6.5625 * temp * (1.0 - 5.0 * x * x)
+      };
+    }
+  } TriweightKernelDerivatives;
+
+  struct {
+    inline KernelDerivatives operator()(const double x) {
+      const double abs_x = std::abs(x);
+      if (abs_x > 1.0) return KernelDerivatives{0.0, 0.0, 0.0};
+      const double abs_x3 = abs_x * abs_x * abs_x;
+      const double temp = 1 - abs_x3;
+      return KernelDerivatives{
+        0.86419753086 * (temp * temp * temp),
+        -9.0 * 0.86419753086 * (temp * temp) * x * abs_x,
+        -18.0 * 0.86419753086 * temp * abs_x * (temp - 3.0 * abs_x3)
+      };
+    }
+  } TricubeKernelDerivatives;
+
+  struct {
+    inline KernelDerivatives operator()(const double x) {
+      if (std::abs(x) > 1.0) return KernelDerivatives{0.0, 0.0, 0.0};
+      const double k = M_PI_4 * std::cos(M_PI_2 * x);
+      return KernelDerivatives{k, -M_PI_4 * M_PI_2 * std::sin(M_PI_2 * x), -M_PI_2 * M_PI_2 * k};
+    }
+  } CosineKernelDerivatives;
+
+  struct {
+    inline KernelDerivatives operator()(const double x) {
+      const double k = 1.0 / (std::exp(x) + 2 + std::exp(-x));
+      const double t = std::tanh(0.5 * x);
+      return KernelDerivatives{k, -k * t, k * (t * t - 2.0 * k)};
+    }
+  } LogisticKernelDerivatives;
+
+  struct {
+    inline KernelDerivatives operator()(const double x) {
+      const double k = M_2_PI * (1.0 / (std::exp(x) + std::exp(-x)));
+      const double t = std::tanh(x);
+      return KernelDerivatives{k, -k * t, k * (2.0 * t * t - 1.0)};
+    }
+  } SigmoidFunctionKernelDerivatives;
 } 
 
 #endif  // FSCR_KDE_KERNELS_HPP
\ No newline at end of file
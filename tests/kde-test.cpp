@@ -1,6 +1,8 @@
 #include <gtest/gtest.h>
 
 #include <cmath>
+#include <random>
+#include <string>
 
 #include "kde-fscr.hpp"
 #include "kde-kernels.hpp"
@@ -18,6 +20,17 @@ namespace {
     }
     return ret;
   }
+
+  // local maxima of the pdf found by a dense grid sweep, reference for fscr::KDE::modes()
+  std::vector<double> grid_modes(const std::vector<double>& x_domain, const std::vector<double>& y_pdf) {
+    std::vector<double> ret;
+    for (size_t i=1; i+1<y_pdf.size(); ++i) {
+      if (y_pdf[i] > y_pdf[i - 1] && y_pdf[i] >= y_pdf[i + 1]) {
+        ret.push_back(x_domain[i]);
+      }
+    }
+    return ret;
+  }
 } //anonymous namespace
 
 TEST(KernelFunc, tc1GaussianKernel) {
@@ -389,3 +402,289 @@ TEST(KDE_PDF_KTriangularBCustom, tc2NormalInputFloat) {
     EXPECT_NEAR(y_pdf[i], expectedValue[i], absoluteError);
   }
 }
+
+TEST(KernelDerivativesFunc, tc1GaussianKernelDerivatives) {
+  const fscr::KernelDerivatives d0 = fscr::GaussianKernelDerivatives(0);
+  EXPECT_NEAR(d0.value, 0.3989422804, absoluteError);
+  EXPECT_NEAR(d0.first, 0, absoluteError);
+  EXPECT_NEAR(d0.second, -0.3989422804, absoluteError);
+
+  const fscr::KernelDerivatives d1 = fscr::GaussianKernelDerivatives(1);
+  EXPECT_NEAR(d1.value, 0.24197072451, absoluteError);
+  EXPECT_NEAR(d1.first, -0.24197072451, absoluteError);
+  EXPECT_NEAR(d1.second, 0, absoluteError);
+}
+
+TEST(KernelDerivativesFunc, tc2MatchesKernelFiniteDifference) {
+  const double eps = 1e-4;
+  const std::vector<double> xs{-2.5, -0.7, -0.3, 0.2, 0.6, 0.9, 3.1};
+  for (const auto x: xs) {
+    const fscr::KernelDerivatives d = fscr::EpanechnikovKernelDerivatives(x);
+    EXPECT_NEAR(d.value, fscr::EpanechnikovKernel(x), absoluteError);
+    EXPECT_NEAR(d.first, (fscr::EpanechnikovKernel(x + eps) - fscr::EpanechnikovKernel(x - eps)) / (2 * eps), 1e-4);
+    EXPECT_NEAR(d.second, (fscr::EpanechnikovKernel(x + eps) - 2 * fscr::EpanechnikovKernel(x) + fscr::EpanechnikovKernel(x - eps)) / (eps * eps), 1e-3);
+
+    const fscr::KernelDerivatives q = fscr::QuarticKernelDerivatives(x);
+    EXPECT_NEAR(q.value, fscr::QuarticKernel(x), absoluteError);
+    EXPECT_NEAR(q.first, (fscr::QuarticKernel(x + eps) - fscr::QuarticKernel(x - eps)) / (2 * eps), 1e-4);
+    EXPECT_NEAR(q.second, (fscr::QuarticKernel(x + eps) - 2 * fscr::QuarticKernel(x) + fscr::QuarticKernel(x - eps)) / (eps * eps), 1e-3);
+
+    const fscr::KernelDerivatives tw = fscr::TriweightKernelDerivatives(x);
+    EXPECT_NEAR(tw.first, (fscr::TriweightKernel(x + eps) - fscr::TriweightKernel(x - eps)) / (2 * eps), 1e-4);
+    EXPECT_NEAR(tw.second, (fscr::TriweightKernel(x + eps) - 2 * fscr::TriweightKernel(x) + fscr::TriweightKernel(x - eps)) / (eps * eps), 1e-3);
+
+    const fscr::KernelDerivatives tc = fscr::TricubeKernelDerivatives(x);
+    EXPECT_NEAR(tc.first, (fscr::TricubeKernel(x + eps) - fscr::TricubeKernel(x - eps)) / (2 * eps), 1e-4);
+    EXPECT_NEAR(tc.second, (fscr::TricubeKernel(x + eps) - 2 * fscr::TricubeKernel(x) + fscr::TricubeKernel(x - eps)) / (eps * eps), 1e-3);
+
+    const fscr::KernelDerivatives c = fscr::CosineKernelDerivatives(x);
+    EXPECT_NEAR(c.first, (fscr::CosineKernel(x + eps) - fscr::CosineKernel(x - eps)) / (2 * eps), 1e-4);
+    EXPECT_NEAR(c.second, (fscr::CosineKernel(x + eps) - 2 * fscr::CosineKernel(x) + fscr::CosineKernel(x - eps)) / (eps * eps), 1e-3);
+
+    const fscr::KernelDerivatives l = fscr::LogisticKernelDerivatives(x);
+    EXPECT_NEAR(l.first, (fscr::LogisticKernel(x + eps) - fscr::LogisticKernel(x - eps)) / (2 * eps), 1e-4);
+    EXPECT_NEAR(l.second, (fscr::LogisticKernel(x + eps) - 2 * fscr::LogisticKernel(x) + fscr::LogisticKernel(x - eps)) / (eps * eps), 1e-3);
+
+    const fscr::KernelDerivatives s = fscr::SigmoidFunctionKernelDerivatives(x);
+    EXPECT_NEAR(s.first, (fscr::SigmoidFunctionKernel(x + eps) - fscr::SigmoidFunctionKernel(x - eps)) / (2 * eps), 1e-4);
+    EXPECT_NEAR(s.second, (fscr::SigmoidFunctionKernel(x + eps) - 2 * fscr::SigmoidFunctionKernel(x) + fscr::SigmoidFunctionKernel(x - eps)) / (eps * eps), 1e-3);
+  }
+}
+
+TEST(KDE_PDFDerivatives, tc1EmptyData) {
+  const std::vector<double> series{};
+  const std::vector<double> x_domain = linspace(-7, 11, 10);
+  const fscr::KDE::PdfDerivatives y = fscr::KDE::pdf_derivatives(series, x_domain);
+
+  EXPECT_EQ(y.pdf.size(), 0);
+  EXPECT_EQ(y.first.size(), 0);
+  EXPECT_EQ(y.second.size(), 0);
+}
+
+TEST(KDE_PDFDerivatives_KGaussianBScott, tc1MatchesPdf) {
+  const std::vector<double> series{6.2, 5.1, 1.9, -0.4, -1.3, -2.1};
+  const size_t num = 10;
+  const std::vector<double> x_domain = linspace(-7, 11, num);
+
+  const fscr::KDE::PdfDerivatives y = fscr::KDE::pdf_derivatives(series, x_domain);
+  const std::vector<double> y_pdf = fscr::KDE::pdf(series, x_domain);
+
+  EXPECT_EQ(y.pdf.size(), num);
+  EXPECT_EQ(y.first.size(), num);
+  EXPECT_EQ(y.second.size(), num);
+  for (auto i=0; i<num; ++i) {
+    EXPECT_NEAR(y.pdf[i], y_pdf[i], 1e-12);
+  }
+}
+
+TEST(KDE_PDFDerivatives_KGaussianBCustom, tc1FiniteDifference) {
+  const std::vector<double> series{6.2, 5.1, 1.9, -0.4, -1.3, -2.1};
+  const double eps = 1e-4;
+  const std::vector<double> x_domain = linspace(-7, 11, 10);
+
+  const fscr::KDE::PdfDerivatives y = fscr::KDE::pdf_derivatives(series, x_domain, std::sqrt(2.25));
+  for (auto i=0; i<x_domain.size(); ++i) {
+    const std::vector<double> around{x_domain[i] - eps, x_domain[i], x_domain[i] + eps};
+    const std::vector<double> f = fscr::KDE::pdf(series, around, std::sqrt(2.25));
+    EXPECT_NEAR(y.first[i], (f[2] - f[0]) / (2 * eps), 1e-6);
+    EXPECT_NEAR(y.second[i], (f[2] - 2 * f[1] + f[0]) / (eps * eps), 1e-4);
+  }
+}
+
+TEST(KDE_Modes, tc1EmptyData) {
+  const std::vector<double> series{};
+  EXPECT_EQ(fscr::KDE::modes(series).size(), 0);
+}
+
+TEST(KDE_Modes_KGaussianBCustom, tc1TwoPeaks) {
+  const std::vector<double> series{6.2, 5.1, 1.9, -0.4, -1.3, -2.1};
+  const double h = std::sqrt(2.25);
+
+  const std::vector<fscr::KDE::Mode> peaks = fscr::KDE::modes(series, h);
+  EXPECT_EQ(peaks.size(), 2);
+
+  // the peaks must agree with a dense grid sweep of the pdf
+  const std::vector<double> x_domain = linspace(-7, 11, 18001);
+  const std::vector<double> y_pdf = fscr::KDE::pdf(series, x_domain, h);
+  const std::vector<double> expected = grid_modes(x_domain, y_pdf);
+
+  EXPECT_EQ(expected.size(), peaks.size());
+  for (auto i=0; i<peaks.size() && i<expected.size(); ++i) {
+    EXPECT_NEAR(peaks[i].location, expected[i], 1e-3);
+    const fscr::KDE::PdfDerivatives d = fscr::KDE::pdf_derivatives(series, std::vector<double>{peaks[i].location}, h);
+    EXPECT_NEAR(d.first[0], 0, 1e-9);
+    EXPECT_NEAR(peaks[i].density, d.pdf[0], 1e-12);
+    EXPECT_NEAR(peaks[i].curvature, d.second[0], 1e-12);
+    EXPECT_LT(peaks[i].curvature, 0);
+  }
+}
+
+TEST(KDE_Modes_KEpanechnikovBCustom, tc1Bimodal) {
+  const std::vector<double> series{-3.1, -2.9, -3.0, -2.8, -3.2, 4.0, 4.1, 3.9, 4.2, 3.8};
+
+  const std::vector<fscr::KDE::Mode> peaks = fscr::KDE::modes(series, fscr::EpanechnikovKernelDerivatives, 1.0);
+  EXPECT_EQ(peaks.size(), 2);
+  if (peaks.size() == 2) {
+    EXPECT_NEAR(peaks[0].location, -3.0, 1e-6);
+    EXPECT_NEAR(peaks[1].location, 4.0, 1e-6);
+    EXPECT_NEAR(peaks[0].density, peaks[1].density, 1e-9);
+    EXPECT_LT(peaks[0].curvature, 0);
+  }
+}
+
+TEST(KDE_Modes_KGaussianBScott, tc1MatchesGridSweep) {
+  const std::vector<double> series{6.2, 5.1, 1.9, -0.4, -1.3, -2.1};
+  const std::vector<double> x_domain = linspace(-7, 11, 18001);
+  const std::vector<double> expected = grid_modes(x_domain, fscr::KDE::pdf(series, x_domain));
+
+  const std::vector<fscr::KDE::Mode> peaks = fscr::KDE::modes(series);
+  EXPECT_EQ(peaks.size(), expected.size());
+  for (auto i=0; i<peaks.size() && i<expected.size(); ++i) {
+    EXPECT_NEAR(peaks[i].location, expected[i], 1e-3);
+    EXPECT_LT(peaks[i].curvature, 0);
+  }
+}
+
+TEST(KDE_Modes_KGaussianBSilverman, tc1MatchesGridSweep) {
+  const std::vector<double> series{6.2, 5.1, 1.9, -0.4, -1.3, -2.1};
+  const std::vector<double> x_domain = linspace(-7, 11, 18001);
+  const std::vector<double> expected = grid_modes(x_domain, fscr::KDE::pdf(series, x_domain, fscr::KDE::Bandwith::Silverman));
+
+  const std::vector<fscr::KDE::Mode> peaks = fscr::KDE::modes(series, fscr::KDE::Bandwith::Silverman);
+  EXPECT_EQ(peaks.size(), expected.size());
+  for (auto i=0; i<peaks.size() && i<expected.size(); ++i) {
+    EXPECT_NEAR(peaks[i].location, expected[i], 1e-3);
+    EXPECT_LT(peaks[i].curvature, 0);
+  }
+}
+
+TEST(KDE_Modes_KGaussianBSilverman, tc2ZeroIQR) {
+  // quantized data with IQR = 0 must still get a positive bandwith
+  const std::vector<double> series{1, 1, 1, 1, 1, 1, 1, 1, 5};
+
+  const std::vector<fscr::KDE::Mode> peaks = fscr::KDE::modes(series, fscr::KDE::Bandwith::Silverman);
+  ASSERT_GE(peaks.size(), 1);
+  EXPECT_NEAR(peaks[0].location, 1.0, 0.1);
+  EXPECT_TRUE(std::isfinite(peaks[0].density));
+  EXPECT_LT(peaks[0].curvature, 0);
+}
+
+TEST(KDE_Modes_KGaussianBCustom, tc2IsolatedMinimum) {
+  // f'(0) underflows to exactly 0, the peak at the minimum must not be dropped
+  const std::vector<double> series{0, 1000, 1000.5};
+
+  const std::vector<fscr::KDE::Mode> peaks = fscr::KDE::modes(series, 1.0);
+  ASSERT_EQ(peaks.size(), 2);
+  EXPECT_NEAR(peaks[0].location, 0.0, 1e-6);
+  EXPECT_NEAR(peaks[1].location, 1000.25, 1e-6);
+  EXPECT_LT(peaks[0].curvature, 0);
+}
+
+TEST(KDE_Modes_KGaussianBCustom, tc3InvalidBandwith) {
+  const std::vector<double> series{6.2, 5.1, 1.9, -0.4, -1.3, -2.1};
+
+  EXPECT_EQ(fscr::KDE::modes(series, 0.0).size(), 0);
+  EXPECT_EQ(fscr::KDE::modes(series, -1.0).size(), 0);
+  EXPECT_EQ(fscr::KDE::modes(series, std::nan("")).size(), 0);
+  EXPECT_EQ(fscr::KDE::pdf_derivatives(series, series, -1.0).pdf.size(), 0);
+}
+
+TEST(KDE_Modes_KGaussianBScott, tc2IdenticalData) {
+  // zero spread gives no usable bandwith; with a custom one the single peak is well defined
+  const std::vector<double> series{3, 3, 3};
+  EXPECT_EQ(fscr::KDE::modes(series).size(), 0);
+
+  const std::vector<fscr::KDE::Mode> peaks = fscr::KDE::modes(series, 1.0);
+  ASSERT_EQ(peaks.size(), 1);
+  EXPECT_NEAR(peaks[0].location, 3.0, 1e-9);
+  EXPECT_NEAR(peaks[0].density, 0.3989422804, absoluteError);
+  EXPECT_NEAR(peaks[0].curvature, -0.3989422804, absoluteError);
+}
+
+TEST(KDE_Modes_KEpanechnikovBCustom, tc2IsolatedMinimum) {
+  const std::vector<double> series{0, 10};
+
+  const std::vector<fscr::KDE::Mode> peaks = fscr::KDE::modes(series, fscr::EpanechnikovKernelDerivatives, 1.0);
+  ASSERT_EQ(peaks.size(), 2);
+  EXPECT_NEAR(peaks[0].location, 0.0, 1e-9);
+  EXPECT_NEAR(peaks[1].location, 10.0, 1e-9);
+  EXPECT_NEAR(peaks[0].curvature, -0.75, 1e-9);
+}
+
+TEST(KDE_Modes_KGaussianBSilverman, tc3HeavyTailPassCount) {
+  // integer lognormal latencies with a far outlier: the seeds must not sweep the whole range
+  std::mt19937 gen(42);
+  std::lognormal_distribution<double> latency(4.0, 1.0);
+  std::vector<double> series(20000);
+  for (auto& x: series) {
+    x = std::round(latency(gen));
+  }
+  series.push_back(20000);
+
+  size_t kernel_calls = 0;
+  auto counting_kernel = [&kernel_calls](const double x) {
+    ++kernel_calls;
+    return fscr::GaussianKernelDerivatives(x);
+  };
+
+  const std::vector<fscr::KDE::Mode> peaks = fscr::KDE::modes(series, counting_kernel, fscr::KDE::Bandwith::Silverman);
+  ASSERT_GE(peaks.size(), 1);
+  EXPECT_EQ(kernel_calls % series.size(), 0);
+
+  const size_t passes = kernel_calls / series.size();
+  EXPECT_LE(passes, fscr::KDE::max_mode_seeds() + 20 * peaks.size());
+}
+
+TEST(KDE_Modes_KGaussianBCustom, tc4ManySeparatedClusters) {
+  // 40 lone points cost 3 seeds each, well within the seed budget
+  std::vector<double> series;
+  for (auto i=0; i<40; ++i) {
+    series.push_back(10.0 * i);
+  }
+
+  testing::internal::CaptureStderr();
+  const std::vector<fscr::KDE::Mode> peaks = fscr::KDE::modes(series, 1.0);
+  EXPECT_EQ(testing::internal::GetCapturedStderr(), "");
+
+  ASSERT_EQ(peaks.size(), series.size());
+  for (auto i=0; i<peaks.size(); ++i) {
+    EXPECT_NEAR(peaks[i].location, series[i], 1e-9);
+  }
+}
+
+TEST(KDE_Modes_KGaussianBCustom, tc5SeedBudgetWarning) {
+  std::vector<double> clusters;
+  for (auto i=0; i<100; ++i) {
+    clusters.push_back(10.0 * i);
+  }
+  testing::internal::CaptureStderr();
+  const size_t num_cluster_peaks = fscr::KDE::modes(clusters, 1.0).size();
+  const std::string cluster_warning = testing::internal::GetCapturedStderr();
+  EXPECT_LT(num_cluster_peaks, clusters.size());
+  EXPECT_NE(cluster_warning.find("fscr::KDE::modes() - WARNING: seed budget exhausted"), std::string::npos);
+
+  std::vector<double> spread;
+  for (auto i=0; i<200; ++i) {
+    spread.push_back(2.9 * i);
+  }
+  testing::internal::CaptureStderr();
+  fscr::KDE::modes(spread, 1.0);
+  const std::string spread_warning = testing::internal::GetCapturedStderr();
+  EXPECT_NE(spread_warning.find("fscr::KDE::modes() - WARNING: seed budget exhausted"), std::string::npos);
+}
+
+TEST(KDE_Modes_KGaussianBCustom, tc6PeakAndDipBetweenSeeds) {
+  // f' stays positive at both seeds around the peak at ~5.105, only f'' changes sign
+  const std::vector<double> series{3.8858, 9.7616, 13.2482};
+
+  const std::vector<fscr::KDE::Mode> peaks = fscr::KDE::modes(series, 2.6723);
+  ASSERT_EQ(peaks.size(), 2);
+  EXPECT_NEAR(peaks[0].location, 5.105, 1e-3);
+  EXPECT_NEAR(peaks[1].location, 11.3409, 1e-3);
+  EXPECT_LT(peaks[0].curvature, 0);
+  EXPECT_LT(peaks[1].curvature, 0);
+}
+
+TEST(KDE_Modes, tc2MaxModeSeeds) {
+  EXPECT_EQ(fscr::KDE::max_mode_seeds(), 256);
+}